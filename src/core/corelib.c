@@ -1119,6 +1119,7 @@ static void janet_load_libs(JanetTable *env) {
     janet_lib_parse(env);
     janet_lib_compile(env);
     janet_lib_debug(env);
+    janet_lib_sysir(env);
     janet_lib_string(env);
     janet_lib_marsh(env);
 #ifdef JANET_PEG
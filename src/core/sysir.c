@@ -0,0 +1,1862 @@
+/*
+* Copyright (c) 2024 Calvin Rose
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to
+* deal in the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+* sell copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*/
+
+/* The system dialect intermediate representation (sysir) is a compiler
+ * intermediate representation that for "system" languages - similar to C.
+ * The IR can be assembled from Janet data structures, type checked, and
+ * lowered to other targets, currently just C source code. This is all
+ * experimental. */
+
+#ifndef JANET_AMALG
+#include "features.h"
+#include <janet.h>
+#include "util.h"
+#include "vector.h"
+#endif
+
+#include <string.h>
+
+typedef enum {
+    JANET_PRIM_U8,
+    JANET_PRIM_S8,
+    JANET_PRIM_U16,
+    JANET_PRIM_S16,
+    JANET_PRIM_U32,
+    JANET_PRIM_S32,
+    JANET_PRIM_U64,
+    JANET_PRIM_S64,
+    JANET_PRIM_F32,
+    JANET_PRIM_F64,
+    JANET_PRIM_POINTER,
+    JANET_PRIM_BOOLEAN,
+    JANET_PRIM_STRUCT
+} JanetPrim;
+
+/* How we represent each primitive type in generated C code. Keep
+ * in the same order as JanetPrim. */
+/* C spellings of the primitive types, padded to a fixed width and
+ * stored with their lengths so emission can copy the bytes directly
+ * instead of chasing a pointer and running strlen under %s. */
+static const struct {
+    char s[12];
+    uint8_t n;
+} c_prim_names[] = {
+    {"uint8_t", 7},
+    {"int8_t", 6},
+    {"uint16_t", 8},
+    {"int16_t", 7},
+    {"uint32_t", 8},
+    {"int32_t", 7},
+    {"uint64_t", 8},
+    {"int64_t", 7},
+    {"float", 5},
+    {"double", 6},
+    {"void *", 6},
+    {"bool", 4},
+    {"struct", 6}
+};
+
+static void emit_prim_name(JanetBuffer *buffer, JanetPrim prim) {
+    janet_buffer_push_bytes(buffer, (const uint8_t *) c_prim_names[prim].s, c_prim_names[prim].n);
+}
+
+typedef enum {
+    JANET_SYSOP_MOVE,
+    JANET_SYSOP_CAST,
+    JANET_SYSOP_ADD,
+    JANET_SYSOP_SUBTRACT,
+    JANET_SYSOP_MULTIPLY,
+    JANET_SYSOP_DIVIDE,
+    JANET_SYSOP_BAND,
+    JANET_SYSOP_BOR,
+    JANET_SYSOP_BXOR,
+    JANET_SYSOP_BNOT,
+    JANET_SYSOP_SHL,
+    JANET_SYSOP_SHR,
+    JANET_SYSOP_LOAD,
+    JANET_SYSOP_STORE,
+    JANET_SYSOP_GT,
+    JANET_SYSOP_LT,
+    JANET_SYSOP_EQ,
+    JANET_SYSOP_NEQ,
+    JANET_SYSOP_GTE,
+    JANET_SYSOP_LTE,
+    JANET_SYSOP_CONSTANT,
+    JANET_SYSOP_CALL,
+    JANET_SYSOP_RETURN,
+    JANET_SYSOP_JUMP,
+    JANET_SYSOP_BRANCH,
+    JANET_SYSOP_ADDRESS,
+    JANET_SYSOP_CALLK,
+    JANET_SYSOP_TYPE_PRIMITIVE,
+    JANET_SYSOP_TYPE_STRUCT,
+    JANET_SYSOP_TYPE_BIND,
+    JANET_SYSOP_ARG,
+    JANET_SYSOP_FIELD_GET,
+    JANET_SYSOP_FIELD_SET
+} JanetSysOp;
+
+typedef struct {
+    const char *name;
+    JanetSysOp op;
+} JanetSysInstrName;
+
+/* Instruction mnemonics. CALLK and ARG are synthesized while
+ * assembling and have no mnemonic of their own. */
+static const JanetSysInstrName sys_op_names[] = {
+    {"add", JANET_SYSOP_ADD},
+    {"address", JANET_SYSOP_ADDRESS},
+    {"band", JANET_SYSOP_BAND},
+    {"bind", JANET_SYSOP_TYPE_BIND},
+    {"bnot", JANET_SYSOP_BNOT},
+    {"bor", JANET_SYSOP_BOR},
+    {"branch", JANET_SYSOP_BRANCH},
+    {"bxor", JANET_SYSOP_BXOR},
+    {"call", JANET_SYSOP_CALL},
+    {"cast", JANET_SYSOP_CAST},
+    {"constant", JANET_SYSOP_CONSTANT},
+    {"divide", JANET_SYSOP_DIVIDE},
+    {"eq", JANET_SYSOP_EQ},
+    {"fget", JANET_SYSOP_FIELD_GET},
+    {"fset", JANET_SYSOP_FIELD_SET},
+    {"gt", JANET_SYSOP_GT},
+    {"gte", JANET_SYSOP_GTE},
+    {"jump", JANET_SYSOP_JUMP},
+    {"load", JANET_SYSOP_LOAD},
+    {"lt", JANET_SYSOP_LT},
+    {"lte", JANET_SYSOP_LTE},
+    {"move", JANET_SYSOP_MOVE},
+    {"multiply", JANET_SYSOP_MULTIPLY},
+    {"neq", JANET_SYSOP_NEQ},
+    {"prim", JANET_SYSOP_TYPE_PRIMITIVE},
+    {"return", JANET_SYSOP_RETURN},
+    {"shl", JANET_SYSOP_SHL},
+    {"shr", JANET_SYSOP_SHR},
+    {"store", JANET_SYSOP_STORE},
+    {"struct", JANET_SYSOP_TYPE_STRUCT},
+    {"subtract", JANET_SYSOP_SUBTRACT},
+};
+
+/* Every instruction mnemonic is 8 bytes or fewer, so a whole name fits in
+ * one 64 bit word. Hashing that word with a fixed multiplier (found offline
+ * by search over the mnemonic set) maps each name to a distinct slot in a
+ * 64 entry table, so a lookup in the assembler's hot loop is one multiply,
+ * one shift, and one word compare instead of a binary search over the name
+ * table with a string compare per probe. */
+#define SYSOP_HASH_MULTIPLIER 0x58a1207ea6083765ULL
+#define SYSOP_HASH_SHIFT 58
+#define SYSOP_HASH_SLOTS 64
+
+typedef struct {
+    uint64_t word;
+    JanetSysOp op;
+} JanetSysOpSlot;
+
+static JanetSysOpSlot sysop_hash_table[SYSOP_HASH_SLOTS];
+static int sysop_hash_ready = 0;
+
+/* Pack up to 8 name bytes into a word, low byte first regardless of
+ * host byte order. Mnemonics are non-empty so 0 never collides. */
+static uint64_t sysop_hash_word(const uint8_t *name, int32_t len) {
+    uint64_t word = 0;
+    for (int32_t i = 0; i < len; i++) {
+        word |= (uint64_t) name[i] << (8 * i);
+    }
+    return word;
+}
+
+/* Fill the hash table from sys_op_names. Idempotent, so a redundant
+ * initialization is harmless. */
+static void sysop_hash_init(void) {
+    size_t count = sizeof(sys_op_names) / sizeof(sys_op_names[0]);
+    for (size_t i = 0; i < count; i++) {
+        const char *name = sys_op_names[i].name;
+        uint64_t word = sysop_hash_word((const uint8_t *) name, (int32_t) strlen(name));
+        uint64_t slot = (word * SYSOP_HASH_MULTIPLIER) >> SYSOP_HASH_SHIFT;
+        janet_assert(sysop_hash_table[slot].word == 0, "sysop hash collision");
+        sysop_hash_table[slot].word = word;
+        sysop_hash_table[slot].op = sys_op_names[i].op;
+    }
+    sysop_hash_ready = 1;
+}
+
+/* Look up an instruction mnemonic. Returns 0 if the name is unknown. */
+static int sysop_lookup(const uint8_t *name, int32_t len, JanetSysOp *out) {
+    if (len <= 0 || len > 8) return 0;
+    uint64_t word = sysop_hash_word(name, len);
+    const JanetSysOpSlot *slot = sysop_hash_table +
+                                 ((word * SYSOP_HASH_MULTIPLIER) >> SYSOP_HASH_SHIFT);
+    if (slot->word != word) return 0;
+    *out = slot->op;
+    return 1;
+}
+
+typedef struct {
+    uint32_t type;
+} JanetSysTypeField;
+
+typedef struct {
+    JanetPrim prim;
+    uint32_t field_count;
+    uint32_t field_start;
+} JanetSysTypeInfo;
+
+/* Register, type, and field indices are 16 bit: real register files
+ * stay well under 65536 entries, and halving the operand width doubles
+ * how many instructions fit in a cache line for every pass that walks
+ * the array. The readers below panic on indices that do not fit.
+ * Labels, constant ids, and argument counts keep the full 32 bits. */
+typedef uint16_t JanetSysReg;
+
+typedef struct {
+    JanetSysOp opcode;
+    union {
+        struct {
+            JanetSysReg dest;
+            JanetSysReg lhs;
+            JanetSysReg rhs;
+        } three;
+        struct {
+            JanetSysReg dest;
+            JanetSysReg src;
+        } two;
+        struct {
+            JanetSysReg src;
+        } one;
+        struct {
+            JanetSysReg dest;
+            JanetSysReg callee;
+            uint32_t arg_count;
+        } call;
+        struct {
+            JanetSysReg dest;
+            uint32_t constant;
+        } constant;
+        struct {
+            JanetSysReg dest;
+            uint32_t constant;
+            uint32_t arg_count;
+        } callk;
+        struct {
+            JanetSysReg cond;
+            uint32_t to;
+        } branch;
+        struct {
+            uint32_t to;
+        } jump;
+        struct {
+            JanetSysReg dest_type;
+            JanetPrim prim;
+        } type_prim;
+        struct {
+            JanetSysReg dest_type;
+            uint32_t arg_count;
+            uint32_t arg_offset; /* into packed_args */
+        } type_types;
+        struct {
+            JanetSysReg dest;
+            JanetSysReg type;
+        } type_bind;
+        struct {
+            JanetSysReg args[3];
+        } arg;
+        struct {
+            JanetSysReg r;
+            JanetSysReg st;
+            JanetSysReg field;
+        } field;
+    };
+} JanetSysInstruction;
+
+/* Source locations are only read when lowering emits #line directives
+ * and when printing errors, so they live in a parallel array instead of
+ * inside JanetSysInstruction. That keeps the instruction elements small
+ * and dense for the passes that walk every instruction. */
+typedef struct {
+    int32_t line;
+    int32_t column;
+} JanetSysSrcLoc;
+
+typedef struct {
+    JanetString link_name;
+    uint32_t instruction_count;
+    uint32_t register_count;
+    uint32_t type_def_count;
+    uint32_t field_def_count;
+    uint32_t constant_count;
+    uint32_t parameter_count;
+    JanetSysInstruction *instructions;
+    /* Opcode of each instruction, packed one byte per slot. The lowering
+     * dispatch only needs the opcode for most instructions, and the byte
+     * stream is ~16x denser than loading whole instruction unions. */
+    uint8_t *opcodes;
+    JanetSysSrcLoc *src_locs;
+    uint32_t *types;
+    uint8_t *reg_prims;
+    JanetSysTypeInfo *type_defs;
+    JanetSysTypeField *field_defs;
+    /* Struct field type ids packed contiguously in declaration order, so
+     * consumers can walk one linear stream instead of gathering operands
+     * out of the trailing ARG instructions. */
+    uint32_t *packed_args;
+    uint32_t packed_arg_count;
+    Janet *constants;
+    /* Scratch output buffer reused by (sysir/to-c) when the caller does
+     * not pass one, so repeated lowering of the same unit keeps its
+     * right-sized allocation instead of growing a fresh buffer each
+     * time. GC-managed; kept alive via sysir_gcmark. */
+    JanetBuffer *scratch;
+    /* Lazily built cache of the %j-formatted spelling of each constant,
+     * so a callee constant referenced from many call sites only runs
+     * the jdn printer once. NULL until lowering first needs it. */
+    JanetString *constant_strs;
+    /* Once assembly succeeds, all backing arrays above are repacked
+     * into this single allocation (see janet_sysir_freeze) and freed as
+     * one pointer. NULL if construction panicked before freezing, in
+     * which case the arrays are still individual allocations. */
+    void *arena;
+} JanetSysIR;
+
+/* The assertions take the already-loaded tuple length rather than the
+ * tuple so the parse loop reads the tuple header once per instruction
+ * instead of once per check. */
+static void instr_assert_length(int32_t actual, int32_t len, Janet x) {
+    if (JANET_UNLIKELY(actual != len)) {
+        janet_panicf("expected instruction of length %d, got %v", len, x);
+    }
+}
+
+static void instr_assert_min_length(int32_t actual, int32_t minlen, Janet x) {
+    if (JANET_UNLIKELY(actual < minlen)) {
+        janet_panicf("expected instruction of at least length %d, got %v", minlen, x);
+    }
+}
+
+static JanetSysReg instr_read_operand(Janet x, JanetSysIR *ir) {
+    if (JANET_UNLIKELY(!janet_checkuint(x))) janet_panicf("expected non-negative integer operand, got %v", x);
+    uint32_t operand = (uint32_t) janet_unwrap_number(x);
+    if (JANET_UNLIKELY(operand > UINT16_MAX)) janet_panicf("register index out of range, got %v", x);
+    if (operand >= ir->register_count) {
+        ir->register_count = operand + 1;
+    }
+    return (JanetSysReg) operand;
+}
+
+static JanetSysReg instr_read_field(Janet x, JanetSysIR *ir) {
+    if (JANET_UNLIKELY(!janet_checkuint(x))) janet_panicf("expected non-negative field index, got %v", x);
+    (void) ir; /* Perhaps support syntax for named fields instead of numbered fields */
+    uint32_t operand = (uint32_t) janet_unwrap_number(x);
+    if (JANET_UNLIKELY(operand > UINT16_MAX)) janet_panicf("field index out of range, got %v", x);
+    return (JanetSysReg) operand;
+}
+
+static JanetSysReg instr_read_type_operand(Janet x, JanetSysIR *ir) {
+    if (JANET_UNLIKELY(!janet_checkuint(x))) janet_panicf("expected non-negative integer operand, got %v", x);
+    uint32_t operand = (uint32_t) janet_unwrap_number(x);
+    if (JANET_UNLIKELY(operand > UINT16_MAX)) janet_panicf("type index out of range, got %v", x);
+    if (operand >= ir->type_def_count) {
+        ir->type_def_count = operand + 1;
+    }
+    return (JanetSysReg) operand;
+}
+
+/* The first two characters pick out every primitive type name, so a
+ * nested switch beats a binary search here: the numeric names resolve
+ * with two byte compares and no strcmp at all. Symbols are NUL
+ * terminated, so peeking at sym[1] is safe even for one-byte names. */
+static JanetPrim instr_read_prim(Janet x) {
+    if (JANET_UNLIKELY(!janet_checktype(x, JANET_SYMBOL))) {
+        janet_panicf("expected primitive type, got %v", x);
+    }
+    JanetSymbol sym_type = janet_unwrap_symbol(x);
+    const uint8_t *s = sym_type;
+    int32_t len = janet_string_length(sym_type);
+    switch (s[0]) {
+        default:
+            break;
+        case 'u':
+            if (len == 2 && s[1] == '8') return JANET_PRIM_U8;
+            if (len != 3) break;
+            if (s[1] == '1' && s[2] == '6') return JANET_PRIM_U16;
+            if (s[1] == '3' && s[2] == '2') return JANET_PRIM_U32;
+            if (s[1] == '6' && s[2] == '4') return JANET_PRIM_U64;
+            break;
+        case 's':
+            if (len == 2 && s[1] == '8') return JANET_PRIM_S8;
+            if (len == 6 && !memcmp(s, "struct", 6)) return JANET_PRIM_STRUCT;
+            if (len != 3) break;
+            if (s[1] == '1' && s[2] == '6') return JANET_PRIM_S16;
+            if (s[1] == '3' && s[2] == '2') return JANET_PRIM_S32;
+            if (s[1] == '6' && s[2] == '4') return JANET_PRIM_S64;
+            break;
+        case 'f':
+            if (len != 3) break;
+            if (s[1] == '3' && s[2] == '2') return JANET_PRIM_F32;
+            if (s[1] == '6' && s[2] == '4') return JANET_PRIM_F64;
+            break;
+        case 'b':
+            if (len == 7 && !memcmp(s, "boolean", 7)) return JANET_PRIM_BOOLEAN;
+            break;
+        case 'p':
+            if (len == 7 && !memcmp(s, "pointer", 7)) return JANET_PRIM_POINTER;
+            break;
+    }
+    janet_panicf("unknown primitive type %v", x);
+}
+
+/* TODO - add named labels back. For now labels are just instruction
+ * indices, so go straight to the number check rather than paying a
+ * table probe per branch that can never hit. When named labels return
+ * they should use a small sorted array keyed on the symbol pointer,
+ * not a full JanetTable. */
+static uint32_t instr_read_label(Janet x) {
+    if (JANET_LIKELY(janet_checkuint(x))) {
+        return (uint32_t) janet_unwrap_number(x);
+    }
+    janet_panicf("expected label, got %v", x);
+}
+
+/* Deduplicate constants during parsing. The keys are almost always
+ * numbers and symbols and the mapping is discarded as soon as parsing
+ * ends, so a full JanetTable is more machinery than the job needs. Use
+ * a small open-addressed map with linear probing that stays hot in L1.
+ * Cells live in scratch memory so a mid-parse panic cannot leak them. */
+
+typedef struct {
+    Janet key;
+    uint32_t value;
+    int used;
+} JanetSysConstCell;
+
+typedef struct {
+    JanetSysConstCell *cells;
+    /* Constants in mint order; cell values index into this, so the
+     * final constants[] array is just a flatten of it. */
+    Janet *ordered;
+    uint32_t capacity; /* always a power of two */
+    uint32_t count;
+} JanetSysConstCache;
+
+static void sysir_constcache_init(JanetSysConstCache *cache) {
+    cache->capacity = 16;
+    cache->count = 0;
+    cache->cells = janet_smalloc(sizeof(JanetSysConstCell) * cache->capacity);
+    cache->ordered = NULL;
+    memset(cache->cells, 0, sizeof(JanetSysConstCell) * cache->capacity);
+}
+
+/* Get the constant index for a value, minting a new index the first
+ * time a value is seen. */
+static uint32_t sysir_constcache_intern(JanetSysConstCache *cache, Janet key, uint32_t *next_constant) {
+    /* Grow at 3/4 load to keep probe runs short */
+    if (cache->count * 4 >= cache->capacity * 3) {
+        JanetSysConstCell *old_cells = cache->cells;
+        uint32_t old_capacity = cache->capacity;
+        cache->capacity *= 2;
+        cache->cells = janet_smalloc(sizeof(JanetSysConstCell) * cache->capacity);
+        memset(cache->cells, 0, sizeof(JanetSysConstCell) * cache->capacity);
+        for (uint32_t i = 0; i < old_capacity; i++) {
+            if (!old_cells[i].used) continue;
+            uint32_t j = (uint32_t) janet_hash(old_cells[i].key) & (cache->capacity - 1);
+            while (cache->cells[j].used) {
+                j = (j + 1) & (cache->capacity - 1);
+            }
+            cache->cells[j] = old_cells[i];
+        }
+        janet_sfree(old_cells);
+    }
+    uint32_t mask = cache->capacity - 1;
+    uint32_t i = (uint32_t) janet_hash(key) & mask;
+    while (cache->cells[i].used) {
+        if (janet_equals(cache->cells[i].key, key)) {
+            return cache->cells[i].value;
+        }
+        i = (i + 1) & mask;
+    }
+    cache->cells[i].used = 1;
+    cache->cells[i].key = key;
+    cache->cells[i].value = (*next_constant)++;
+    cache->count++;
+    janet_v_push(cache->ordered, key);
+    return cache->cells[i].value;
+}
+
+/* Shared parse body for every three-operand instruction. */
+static void parse_three(JanetSysInstruction *ins, JanetTuple tuple, int32_t tlen, Janet opvalue, JanetSysIR *out) {
+    instr_assert_length(tlen, 4, opvalue);
+    ins->three.dest = instr_read_operand(tuple[1], out);
+    ins->three.lhs = instr_read_operand(tuple[2], out);
+    ins->three.rhs = instr_read_operand(tuple[3], out);
+}
+
+static void janet_sysir_init_instructions(JanetSysIR *out, JanetView instructions) {
+
+    /* Most source tuples emit exactly one instruction; calls and struct
+     * type definitions emit trailing ARG instructions as well, so leave
+     * some headroom and grow geometrically when the estimate is off. */
+    size_t ircap = instructions.len ? (size_t) instructions.len * 2 + 8 : 16;
+    JanetSysInstruction *ir = janet_malloc(sizeof(JanetSysInstruction) * ircap);
+    JanetSysSrcLoc *src_locs = janet_malloc(sizeof(JanetSysSrcLoc) * ircap);
+    if (NULL == ir || NULL == src_locs) {
+        JANET_OUT_OF_MEMORY;
+    }
+    out->instructions = ir;
+    out->src_locs = src_locs;
+    uint32_t cursor = 0;
+
+#define PUSH_INSTR(in) do { \
+    if (cursor == ircap) { \
+        ircap *= 2; \
+        ir = janet_realloc(ir, sizeof(JanetSysInstruction) * ircap); \
+        src_locs = janet_realloc(src_locs, sizeof(JanetSysSrcLoc) * ircap); \
+        if (NULL == ir || NULL == src_locs) { \
+            JANET_OUT_OF_MEMORY; \
+        } \
+        out->instructions = ir; \
+        out->src_locs = src_locs; \
+    } \
+    ir[cursor] = (in); \
+    src_locs[cursor] = srcloc; \
+    cursor++; \
+} while (0)
+    JanetSysConstCache constant_cache;
+    sysir_constcache_init(&constant_cache);
+    uint32_t next_constant = 0;
+    uint32_t *packed_args = NULL;
+    int in_type_section = 1;
+
+    /* Parse instructions */
+    for (int32_t i = 0; i < instructions.len; i++) {
+        Janet x = instructions.items[i];
+        if (JANET_UNLIKELY(!janet_checktype(x, JANET_TUPLE))) {
+            janet_panicf("expected instruction to be tuple, got %v", x);
+        }
+        JanetTuple tuple = janet_unwrap_tuple(x);
+        int32_t tlen = janet_tuple_length(tuple);
+        if (JANET_UNLIKELY(tlen < 1)) {
+            janet_panicf("invalid instruction, got %v", x);
+        }
+        Janet opvalue = tuple[0];
+        if (JANET_UNLIKELY(!janet_checktype(opvalue, JANET_SYMBOL))) {
+            janet_panicf("expected opcode symbol, found %v", opvalue);
+        }
+        JanetSymbol opsymbol = janet_unwrap_symbol(opvalue);
+        JanetSysOp opcode;
+        if (JANET_UNLIKELY(!sysop_lookup(opsymbol, janet_string_length(opsymbol), &opcode))) {
+            janet_panicf("unknown instruction %v", x);
+        }
+        /* Lowering emits typedefs from the leading type section only,
+         * so a prim or struct declaration after the first body
+         * instruction would be silently dropped and leave the emitted C
+         * referencing undefined types. Reject it here instead. */
+        if (opcode == JANET_SYSOP_TYPE_PRIMITIVE || opcode == JANET_SYSOP_TYPE_STRUCT) {
+            if (JANET_UNLIKELY(!in_type_section)) {
+                janet_panicf("type declaration after the start of the function body, got %v", x);
+            }
+        } else if (opcode != JANET_SYSOP_TYPE_BIND) {
+            in_type_section = 0;
+        }
+        JanetSysInstruction instruction;
+        instruction.opcode = opcode;
+        JanetSysSrcLoc srcloc;
+        srcloc.line = janet_tuple_sm_line(tuple);
+        srcloc.column = janet_tuple_sm_column(tuple);
+        switch (opcode) {
+            case JANET_SYSOP_CALLK:
+            case JANET_SYSOP_ARG:
+                janet_assert(0, "unreachable");
+                break;
+            /* All arithmetic, bitwise, and comparison instructions
+             * parse identically; one body keeps the parse switch small
+             * enough to stay resident in the I-cache. */
+            case JANET_SYSOP_ADD:
+            case JANET_SYSOP_SUBTRACT:
+            case JANET_SYSOP_MULTIPLY:
+            case JANET_SYSOP_DIVIDE:
+            case JANET_SYSOP_BAND:
+            case JANET_SYSOP_BOR:
+            case JANET_SYSOP_BXOR:
+            case JANET_SYSOP_SHL:
+            case JANET_SYSOP_SHR:
+            case JANET_SYSOP_GT:
+            case JANET_SYSOP_GTE:
+            case JANET_SYSOP_LT:
+            case JANET_SYSOP_LTE:
+            case JANET_SYSOP_EQ:
+            case JANET_SYSOP_NEQ:
+                parse_three(&instruction, tuple, tlen, opvalue, out);
+                PUSH_INSTR(instruction);
+                break;
+            case JANET_SYSOP_MOVE:
+            case JANET_SYSOP_CAST:
+            case JANET_SYSOP_LOAD:
+            case JANET_SYSOP_STORE:
+            case JANET_SYSOP_ADDRESS:
+            case JANET_SYSOP_BNOT: {
+                instr_assert_length(tlen, 3, opvalue);
+                instruction.two.dest = instr_read_operand(tuple[1], out);
+                instruction.two.src = instr_read_operand(tuple[2], out);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_RETURN: {
+                instr_assert_length(tlen, 2, opvalue);
+                instruction.one.src = instr_read_operand(tuple[1], out);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_JUMP: {
+                instr_assert_length(tlen, 2, opvalue);
+                instruction.jump.to = instr_read_label(tuple[1]);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_BRANCH: {
+                instr_assert_length(tlen, 3, opvalue);
+                instruction.branch.cond = instr_read_operand(tuple[1], out);
+                instruction.branch.to = instr_read_label(tuple[2]);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_CONSTANT: {
+                instr_assert_length(tlen, 3, opvalue);
+                instruction.constant.dest = instr_read_operand(tuple[1], out);
+                instruction.constant.constant = sysir_constcache_intern(&constant_cache, tuple[2], &next_constant);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_CALL: {
+                instr_assert_min_length(tlen, 3, opvalue);
+                /* The call and callk variants no longer share a layout
+                 * past the destination, so each branch fills in its own
+                 * variant completely. */
+                JanetSysReg dest = instr_read_operand(tuple[1], out);
+                Janet callee = tuple[2];
+                if (janet_checktype(callee, JANET_NUMBER)) {
+                    instruction.call.dest = dest;
+                    instruction.call.callee = instr_read_operand(callee, out);
+                    instruction.call.arg_count = (uint32_t)(tlen - 3);
+                } else {
+                    /* Calls to named things become constant calls */
+                    instruction.opcode = JANET_SYSOP_CALLK;
+                    instruction.callk.dest = dest;
+                    instruction.callk.constant = sysir_constcache_intern(&constant_cache, callee, &next_constant);
+                    instruction.callk.arg_count = (uint32_t)(tlen - 3);
+                }
+                PUSH_INSTR(instruction);
+                /* Pack the arguments into trailing ARG instructions, three
+                 * operands per instruction. Full triples skip the zero
+                 * fill and the per-iteration remainder check; only a
+                 * partial final triple pays for padding. */
+                int32_t j = 3;
+                for (; j + 3 <= tlen; j += 3) {
+                    JanetSysInstruction arginstr;
+                    arginstr.opcode = JANET_SYSOP_ARG;
+                    arginstr.arg.args[0] = instr_read_operand(tuple[j], out);
+                    arginstr.arg.args[1] = instr_read_operand(tuple[j + 1], out);
+                    arginstr.arg.args[2] = instr_read_operand(tuple[j + 2], out);
+                    PUSH_INSTR(arginstr);
+                }
+                if (j < tlen) {
+                    JanetSysInstruction arginstr;
+                    arginstr.opcode = JANET_SYSOP_ARG;
+                    arginstr.arg.args[0] = 0;
+                    arginstr.arg.args[1] = 0;
+                    arginstr.arg.args[2] = 0;
+                    for (int32_t k = 0; j + k < tlen; k++) {
+                        arginstr.arg.args[k] = instr_read_operand(tuple[j + k], out);
+                    }
+                    PUSH_INSTR(arginstr);
+                }
+                break;
+            }
+            case JANET_SYSOP_TYPE_PRIMITIVE: {
+                instr_assert_length(tlen, 3, opvalue);
+                instruction.type_prim.dest_type = instr_read_type_operand(tuple[1], out);
+                instruction.type_prim.prim = instr_read_prim(tuple[2]);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_TYPE_STRUCT: {
+                instr_assert_min_length(tlen, 2, opvalue);
+                instruction.type_types.dest_type = instr_read_type_operand(tuple[1], out);
+                instruction.type_types.arg_count = tlen - 2;
+                instruction.type_types.arg_offset = (uint32_t) janet_v_count(packed_args);
+                PUSH_INSTR(instruction);
+                /* Pack the field types into trailing ARG instructions as
+                 * with calls, full triples first and a padded tail, and
+                 * also into the flat packed_args stream that downstream
+                 * passes walk linearly. */
+                int32_t j = 2;
+                for (; j + 3 <= tlen; j += 3) {
+                    JanetSysInstruction arginstr;
+                    arginstr.opcode = JANET_SYSOP_ARG;
+                    arginstr.arg.args[0] = instr_read_type_operand(tuple[j], out);
+                    arginstr.arg.args[1] = instr_read_type_operand(tuple[j + 1], out);
+                    arginstr.arg.args[2] = instr_read_type_operand(tuple[j + 2], out);
+                    janet_v_push(packed_args, arginstr.arg.args[0]);
+                    janet_v_push(packed_args, arginstr.arg.args[1]);
+                    janet_v_push(packed_args, arginstr.arg.args[2]);
+                    PUSH_INSTR(arginstr);
+                }
+                if (j < tlen) {
+                    JanetSysInstruction arginstr;
+                    arginstr.opcode = JANET_SYSOP_ARG;
+                    arginstr.arg.args[0] = 0;
+                    arginstr.arg.args[1] = 0;
+                    arginstr.arg.args[2] = 0;
+                    for (int32_t k = 0; j + k < tlen; k++) {
+                        arginstr.arg.args[k] = instr_read_type_operand(tuple[j + k], out);
+                        janet_v_push(packed_args, arginstr.arg.args[k]);
+                    }
+                    PUSH_INSTR(arginstr);
+                }
+                break;
+            }
+            case JANET_SYSOP_TYPE_BIND: {
+                instr_assert_length(tlen, 3, opvalue);
+                instruction.type_bind.dest = instr_read_operand(tuple[1], out);
+                instruction.type_bind.type = instr_read_type_operand(tuple[2], out);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_FIELD_GET: {
+                instr_assert_length(tlen, 4, opvalue);
+                instruction.field.r = instr_read_operand(tuple[1], out);
+                instruction.field.st = instr_read_operand(tuple[2], out);
+                instruction.field.field = instr_read_field(tuple[3], out);
+                PUSH_INSTR(instruction);
+                break;
+            }
+            case JANET_SYSOP_FIELD_SET: {
+                instr_assert_length(tlen, 4, opvalue);
+                instruction.field.st = instr_read_operand(tuple[1], out);
+                instruction.field.field = instr_read_field(tuple[2], out);
+                instruction.field.r = instr_read_operand(tuple[3], out);
+                PUSH_INSTR(instruction);
+                break;
+            }
+        }
+    }
+
+    out->instruction_count = cursor;
+    out->constant_count = next_constant;
+
+    /* The cache recorded constants in mint order, so the final array is
+     * a straight flatten with no scan over empty cells. */
+    out->constants = janet_v_take(constant_cache.ordered, NULL);
+    janet_sfree(constant_cache.cells);
+    int32_t packed_arg_count = 0;
+    out->packed_args = janet_v_take(packed_args, &packed_arg_count);
+    out->packed_arg_count = (uint32_t) packed_arg_count;
+
+    /* Only bother shrinking to fit when the estimate was far off,
+     * which saves the copy a shrinking realloc may do. */
+    if (cursor && cursor < ircap / 2) {
+        ir = janet_realloc(ir, sizeof(JanetSysInstruction) * cursor);
+        src_locs = janet_realloc(src_locs, sizeof(JanetSysSrcLoc) * cursor);
+        if (NULL == ir || NULL == src_locs) {
+            JANET_OUT_OF_MEMORY;
+        }
+        out->instructions = ir;
+        out->src_locs = src_locs;
+    }
+
+    uint8_t *opcodes = janet_malloc(cursor);
+    if (NULL == opcodes && cursor) {
+        JANET_OUT_OF_MEMORY;
+    }
+    for (uint32_t i = 0; i < cursor; i++) {
+        opcodes[i] = (uint8_t) ir[i].opcode;
+    }
+    out->opcodes = opcodes;
+
+#undef PUSH_INSTR
+}
+
+/* Type checking. Class checks on primitives are bit tests against
+ * these masks. */
+
+#define PRIM_MASK(prim) (1u << (prim))
+#define PRIM_INTEGER_MASK \
+    (PRIM_MASK(JANET_PRIM_U8) | PRIM_MASK(JANET_PRIM_S8) | \
+     PRIM_MASK(JANET_PRIM_U16) | PRIM_MASK(JANET_PRIM_S16) | \
+     PRIM_MASK(JANET_PRIM_U32) | PRIM_MASK(JANET_PRIM_S32) | \
+     PRIM_MASK(JANET_PRIM_U64) | PRIM_MASK(JANET_PRIM_S64))
+#define PRIM_NUMBER_MASK \
+    (PRIM_INTEGER_MASK | PRIM_MASK(JANET_PRIM_F32) | PRIM_MASK(JANET_PRIM_F64))
+
+static void tcheck_boolean(JanetSysIR *sysir, uint32_t reg1) {
+    JanetPrim t1 = (JanetPrim) sysir->reg_prims[reg1];
+    if (JANET_UNLIKELY(t1 != JANET_PRIM_BOOLEAN)) {
+        janet_panicf("type failure, expected boolean, got type-id:%d", t1);
+    }
+}
+
+static void tcheck_integer(JanetSysIR *sysir, uint32_t reg1) {
+    JanetPrim t1 = (JanetPrim) sysir->reg_prims[reg1];
+    if (JANET_UNLIKELY(!(PRIM_MASK(t1) & PRIM_INTEGER_MASK))) {
+        janet_panicf("type failure, expected integer, got type-id:%d", t1);
+    }
+}
+
+static void tcheck_pointer(JanetSysIR *sysir, uint32_t reg1) {
+    JanetPrim t1 = (JanetPrim) sysir->reg_prims[reg1];
+    if (JANET_UNLIKELY(t1 != JANET_PRIM_POINTER)) {
+        janet_panicf("type failure, expected pointer, got type-id:%d", t1);
+    }
+}
+
+static void tcheck_struct(JanetSysIR *sysir, uint32_t reg1) {
+    JanetPrim t1 = (JanetPrim) sysir->reg_prims[reg1];
+    if (JANET_UNLIKELY(t1 != JANET_PRIM_STRUCT)) {
+        janet_panicf("type failure, expected struct, got type-id:%d", t1);
+    }
+}
+
+static void tcheck_number(JanetSysIR *sysir, uint32_t reg1) {
+    JanetPrim t1 = (JanetPrim) sysir->reg_prims[reg1];
+    if (JANET_UNLIKELY(!(PRIM_MASK(t1) & PRIM_NUMBER_MASK))) {
+        janet_panicf("type failure, expected numeric type, got type-id:%d", t1);
+    }
+}
+
+static void tcheck_equal(JanetSysIR *sysir, uint32_t reg1, uint32_t reg2) {
+    uint32_t t1 = sysir->types[reg1];
+    uint32_t t2 = sysir->types[reg2];
+    if (JANET_UNLIKELY(t1 != t2)) {
+        janet_panicf("type failure, types %d and %d do not match", t1, t2);
+    }
+}
+
+/* Use the same dispatch trick as the bytecode interpreter in vm.c: with
+ * GNU C extensions, route the per-opcode checks through a table of label
+ * addresses. This drops the switch bounds check and gives the branch
+ * predictor an indirect jump it can learn per opcode. Other compilers
+ * keep the plain switch. The case bodies are tiny, so the dispatch
+ * branch dominates this loop. */
+#if defined(__GNUC__) && !defined(__EMSCRIPTEN__)
+#define JANET_SYSIR_COMPUTED_GOTOS
+#define TC_START() goto *tc_lookup[instruction.opcode];
+#define TC_END()
+#define TC_OP(op) tc_label_##op :
+#else
+#define TC_START() switch (instruction.opcode) {
+#define TC_END() }
+#define TC_OP(op) case op :
+#endif
+#define tc_next() continue
+
+/* Build the type table and the struct field table, and type check in the
+ * same walk. Type declarations and binds precede any use of the register
+ * they describe (already the assembly convention), so both jobs can share
+ * one pass over the instruction array instead of touching it twice.
+ * reg_prims caches the primitive kind of every register as it is bound;
+ * the checks below would otherwise chase types[reg] and then type_defs[t]
+ * for every operand, two dependent loads where one byte load will do. */
+static void janet_sysir_init_types(JanetSysIR *sysir) {
+    JanetSysTypeField *fields = NULL;
+    JanetSysTypeInfo *type_defs = janet_calloc(sysir->type_def_count, sizeof(JanetSysTypeInfo));
+    /* calloc instead of malloc + a zeroing loop: the allocator can hand
+     * back pre-zeroed pages without dirtying the cache on large register
+     * files. */
+    uint32_t *types = janet_calloc(sysir->register_count, sizeof(uint32_t));
+    uint8_t *reg_prims = janet_calloc(sysir->register_count, 1);
+    sysir->type_defs = type_defs;
+    sysir->types = types;
+    sysir->reg_prims = reg_prims;
+
+    for (uint32_t i = 0; i < sysir->instruction_count; i++) {
+        JanetSysInstruction instruction = sysir->instructions[i];
+#ifdef JANET_SYSIR_COMPUTED_GOTOS
+        /* Keep in the same order as JanetSysOp */
+        static void *tc_lookup[] = {
+            &&tc_label_JANET_SYSOP_MOVE,
+            &&tc_label_JANET_SYSOP_CAST,
+            &&tc_label_JANET_SYSOP_ADD,
+            &&tc_label_JANET_SYSOP_SUBTRACT,
+            &&tc_label_JANET_SYSOP_MULTIPLY,
+            &&tc_label_JANET_SYSOP_DIVIDE,
+            &&tc_label_JANET_SYSOP_BAND,
+            &&tc_label_JANET_SYSOP_BOR,
+            &&tc_label_JANET_SYSOP_BXOR,
+            &&tc_label_JANET_SYSOP_BNOT,
+            &&tc_label_JANET_SYSOP_SHL,
+            &&tc_label_JANET_SYSOP_SHR,
+            &&tc_label_JANET_SYSOP_LOAD,
+            &&tc_label_JANET_SYSOP_STORE,
+            &&tc_label_JANET_SYSOP_GT,
+            &&tc_label_JANET_SYSOP_LT,
+            &&tc_label_JANET_SYSOP_EQ,
+            &&tc_label_JANET_SYSOP_NEQ,
+            &&tc_label_JANET_SYSOP_GTE,
+            &&tc_label_JANET_SYSOP_LTE,
+            &&tc_label_JANET_SYSOP_CONSTANT,
+            &&tc_label_JANET_SYSOP_CALL,
+            &&tc_label_JANET_SYSOP_RETURN,
+            &&tc_label_JANET_SYSOP_JUMP,
+            &&tc_label_JANET_SYSOP_BRANCH,
+            &&tc_label_JANET_SYSOP_ADDRESS,
+            &&tc_label_JANET_SYSOP_CALLK,
+            &&tc_label_JANET_SYSOP_TYPE_PRIMITIVE,
+            &&tc_label_JANET_SYSOP_TYPE_STRUCT,
+            &&tc_label_JANET_SYSOP_TYPE_BIND,
+            &&tc_label_JANET_SYSOP_ARG,
+            &&tc_label_JANET_SYSOP_FIELD_GET,
+            &&tc_label_JANET_SYSOP_FIELD_SET
+        };
+#endif
+        TC_START()
+        TC_OP(JANET_SYSOP_CAST)
+        TC_OP(JANET_SYSOP_CONSTANT)
+        TC_OP(JANET_SYSOP_CALL)
+        TC_OP(JANET_SYSOP_RETURN)
+        TC_OP(JANET_SYSOP_CALLK)
+        TC_OP(JANET_SYSOP_ARG)
+        tc_next();
+        TC_OP(JANET_SYSOP_TYPE_PRIMITIVE)
+        type_defs[instruction.type_prim.dest_type].prim = instruction.type_prim.prim;
+        tc_next();
+        TC_OP(JANET_SYSOP_TYPE_STRUCT) {
+            uint32_t field_count = instruction.type_types.arg_count;
+            uint32_t field_start = (uint32_t) janet_v_count(fields);
+            type_defs[instruction.type_types.dest_type].prim = JANET_PRIM_STRUCT;
+            type_defs[instruction.type_types.dest_type].field_count = field_count;
+            type_defs[instruction.type_types.dest_type].field_start = field_start;
+            /* Reserve room for the whole field run up front instead of
+             * paying a capacity check per pushed field. */
+            janet_v__maybegrow(fields, (int32_t) field_count);
+            JanetSysTypeField *slot = fields + field_start;
+            const uint32_t *packed = sysir->packed_args + instruction.type_types.arg_offset;
+            for (uint32_t j = 0; j < field_count; j++) {
+                slot[j].type = packed[j];
+            }
+            janet_v__cnt(fields) = (int32_t)(field_start + field_count);
+            tc_next();
+        }
+        TC_OP(JANET_SYSOP_TYPE_BIND)
+        types[instruction.type_bind.dest] = instruction.type_bind.type;
+        reg_prims[instruction.type_bind.dest] = (uint8_t) type_defs[instruction.type_bind.type].prim;
+        tc_next();
+        TC_OP(JANET_SYSOP_MOVE)
+        tcheck_equal(sysir, instruction.two.dest, instruction.two.src);
+        tc_next();
+        TC_OP(JANET_SYSOP_ADD)
+        TC_OP(JANET_SYSOP_SUBTRACT)
+        TC_OP(JANET_SYSOP_MULTIPLY)
+        TC_OP(JANET_SYSOP_DIVIDE)
+        tcheck_number(sysir, instruction.three.dest);
+        tcheck_equal(sysir, instruction.three.dest, instruction.three.lhs);
+        tcheck_equal(sysir, instruction.three.lhs, instruction.three.rhs);
+        tc_next();
+        TC_OP(JANET_SYSOP_BAND)
+        TC_OP(JANET_SYSOP_BOR)
+        TC_OP(JANET_SYSOP_BXOR)
+        TC_OP(JANET_SYSOP_SHL)
+        TC_OP(JANET_SYSOP_SHR)
+        tcheck_integer(sysir, instruction.three.dest);
+        tcheck_equal(sysir, instruction.three.dest, instruction.three.lhs);
+        tcheck_equal(sysir, instruction.three.lhs, instruction.three.rhs);
+        tc_next();
+        TC_OP(JANET_SYSOP_BNOT)
+        tcheck_integer(sysir, instruction.two.src);
+        tcheck_equal(sysir, instruction.two.dest, instruction.two.src);
+        tc_next();
+        TC_OP(JANET_SYSOP_GT)
+        TC_OP(JANET_SYSOP_GTE)
+        TC_OP(JANET_SYSOP_LT)
+        TC_OP(JANET_SYSOP_LTE)
+        TC_OP(JANET_SYSOP_EQ)
+        TC_OP(JANET_SYSOP_NEQ)
+        tcheck_boolean(sysir, instruction.three.dest);
+        tcheck_equal(sysir, instruction.three.lhs, instruction.three.rhs);
+        tc_next();
+        TC_OP(JANET_SYSOP_LOAD)
+        tcheck_pointer(sysir, instruction.two.src);
+        tc_next();
+        TC_OP(JANET_SYSOP_STORE)
+        tcheck_pointer(sysir, instruction.two.dest);
+        tc_next();
+        TC_OP(JANET_SYSOP_ADDRESS)
+        tcheck_pointer(sysir, instruction.two.dest);
+        tc_next();
+        TC_OP(JANET_SYSOP_BRANCH)
+        tcheck_boolean(sysir, instruction.branch.cond);
+        if (JANET_UNLIKELY(instruction.branch.to >= sysir->instruction_count)) {
+            janet_panicf("label outside of range [0, %u), got %u",
+                         sysir->instruction_count, instruction.branch.to);
+        }
+        tc_next();
+        TC_OP(JANET_SYSOP_JUMP)
+        if (JANET_UNLIKELY(instruction.jump.to >= sysir->instruction_count)) {
+            janet_panicf("label outside of range [0, %u), got %u",
+                         sysir->instruction_count, instruction.jump.to);
+        }
+        tc_next();
+        TC_OP(JANET_SYSOP_FIELD_GET)
+        TC_OP(JANET_SYSOP_FIELD_SET) {
+            tcheck_struct(sysir, instruction.field.st);
+            /* One load of the type info instead of re-indexing
+             * type_defs[] for the count and again for the offset. */
+            JanetSysTypeInfo ti = type_defs[sysir->types[instruction.field.st]];
+            if (JANET_UNLIKELY(instruction.field.field >= ti.field_count)) {
+                janet_panicf("invalid field index %u", instruction.field.field);
+            }
+            uint32_t field_type = fields[ti.field_start + instruction.field.field].type;
+            uint32_t tdest = sysir->types[instruction.field.r];
+            if (JANET_UNLIKELY(field_type != tdest)) {
+                janet_panicf("type failure, types %d and %d do not match", tdest, field_type);
+            }
+            tc_next();
+        }
+        TC_END()
+    }
+
+    int32_t field_def_count = 0;
+    sysir->field_defs = janet_v_take(fields, &field_def_count);
+    sysir->field_def_count = (uint32_t) field_def_count;
+}
+
+/* Repack every backing array into one allocation once assembly has
+ * succeeded. Blocks are laid out in descending alignment order so no
+ * padding is needed, the nine mallocs collapse to one free, and the
+ * arrays the lowering pass walks together end up adjacent in memory. */
+static void janet_sysir_freeze(JanetSysIR *sysir) {
+    size_t constants_size = sizeof(Janet) * sysir->constant_count;
+    size_t type_defs_size = sizeof(JanetSysTypeInfo) * sysir->type_def_count;
+    size_t instructions_size = sizeof(JanetSysInstruction) * sysir->instruction_count;
+    size_t src_locs_size = sizeof(JanetSysSrcLoc) * sysir->instruction_count;
+    size_t types_size = sizeof(uint32_t) * sysir->register_count;
+    size_t packed_args_size = sizeof(uint32_t) * sysir->packed_arg_count;
+    size_t field_defs_size = sizeof(JanetSysTypeField) * sysir->field_def_count;
+    size_t opcodes_size = sysir->instruction_count;
+    size_t reg_prims_size = sysir->register_count;
+    size_t total = constants_size + type_defs_size + instructions_size
+                   + src_locs_size + types_size + packed_args_size
+                   + field_defs_size + opcodes_size + reg_prims_size;
+    uint8_t *base = janet_malloc(total ? total : 1);
+    if (NULL == base) {
+        JANET_OUT_OF_MEMORY;
+    }
+    uint8_t *p = base;
+#define ARENA_MOVE(field, size_) do { \
+    if (size_) { \
+        memcpy(p, sysir->field, (size_)); \
+        janet_free(sysir->field); \
+        sysir->field = (void *) p; \
+        p += (size_); \
+    } else { \
+        janet_free(sysir->field); \
+        sysir->field = NULL; \
+    } \
+} while (0)
+    ARENA_MOVE(constants, constants_size);
+    ARENA_MOVE(type_defs, type_defs_size);
+    ARENA_MOVE(instructions, instructions_size);
+    ARENA_MOVE(src_locs, src_locs_size);
+    ARENA_MOVE(types, types_size);
+    ARENA_MOVE(packed_args, packed_args_size);
+    ARENA_MOVE(field_defs, field_defs_size);
+    ARENA_MOVE(opcodes, opcodes_size);
+    ARENA_MOVE(reg_prims, reg_prims_size);
+#undef ARENA_MOVE
+    sysir->arena = base;
+}
+
+void janet_sys_ir_init_from_table(JanetSysIR *ir, JanetTable *table) {
+    memset(ir, 0, sizeof(JanetSysIR));
+    Janet assembly = janet_table_get(table, janet_ckeywordv("instructions"));
+    Janet param_count = janet_table_get(table, janet_ckeywordv("parameter-count"));
+    Janet link_namev = janet_table_get(table, janet_ckeywordv("link-name"));
+    JanetView asm_view = janet_getindexed(&assembly, 0);
+    if (!janet_checktype(param_count, JANET_NIL)) {
+        if (!janet_checkuint(param_count)) {
+            janet_panicf("expected non-negative integer for :parameter-count, got %v", param_count);
+        }
+        ir->parameter_count = (uint32_t) janet_unwrap_number(param_count);
+    }
+    if (!janet_checktype(link_namev, JANET_NIL)) {
+        ir->link_name = janet_getstring(&link_namev, 0);
+    }
+    janet_sysir_init_instructions(ir, asm_view);
+    janet_sysir_init_types(ir);
+    janet_sysir_freeze(ir);
+}
+
+/* Lowering to C */
+
+#define JANET_SYSOP_COUNT (JANET_SYSOP_FIELD_SET + 1)
+
+/* Emission info per opcode. Opcodes whose C template is just
+ * "dest = lhs <op> rhs" - arithmetic, bit ops, and the six comparisons
+ * alike - are classified SYSIR_CKIND_BINOP and share a single emitter;
+ * everything irregular stays in a much shorter dispatch body. Operator
+ * spellings are stored with their length so emission needs no
+ * strlen. */
+enum {
+    SYSIR_CKIND_OTHER = 0,
+    SYSIR_CKIND_BINOP
+};
+
+static const struct {
+    char kind;
+    char op[4];
+    uint8_t op_len;
+} c_opinfo[JANET_SYSOP_COUNT] = {
+    [JANET_SYSOP_ADD] = {SYSIR_CKIND_BINOP, "+", 1},
+    [JANET_SYSOP_SUBTRACT] = {SYSIR_CKIND_BINOP, "-", 1},
+    [JANET_SYSOP_MULTIPLY] = {SYSIR_CKIND_BINOP, "*", 1},
+    [JANET_SYSOP_DIVIDE] = {SYSIR_CKIND_BINOP, "/", 1},
+    [JANET_SYSOP_BAND] = {SYSIR_CKIND_BINOP, "&", 1},
+    [JANET_SYSOP_BOR] = {SYSIR_CKIND_BINOP, "|", 1},
+    [JANET_SYSOP_BXOR] = {SYSIR_CKIND_BINOP, "^", 1},
+    [JANET_SYSOP_SHL] = {SYSIR_CKIND_BINOP, "<<", 2},
+    [JANET_SYSOP_SHR] = {SYSIR_CKIND_BINOP, ">>", 2},
+    [JANET_SYSOP_GT] = {SYSIR_CKIND_BINOP, ">", 1},
+    [JANET_SYSOP_GTE] = {SYSIR_CKIND_BINOP, ">=", 2},
+    [JANET_SYSOP_LT] = {SYSIR_CKIND_BINOP, "<", 1},
+    [JANET_SYSOP_LTE] = {SYSIR_CKIND_BINOP, "<=", 2},
+    [JANET_SYSOP_EQ] = {SYSIR_CKIND_BINOP, "==", 2},
+    [JANET_SYSOP_NEQ] = {SYSIR_CKIND_BINOP, "!=", 2}
+};
+
+/* Hand-rolled emitters for the hottest lowering templates. janet_formatb
+ * re-parses its format string on every call, which adds up when every
+ * instruction emits several numbered tokens. These write the "_r<N>"
+ * style tokens directly, converting the number in a stack buffer. */
+
+/* Two digits per division step via a 100-entry pair table, so a typical
+ * register number costs one divide and one two-byte copy. */
+static const char emit_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Convert x backwards into the tail of a 16-byte stack slot, two
+ * digits per step. The constant divides lower to multiply-high
+ * sequences, so no division instruction runs here. Returns the start
+ * of the digits; the two bytes below it are free for a prefix. */
+static uint8_t *emit_u32_digits(uint8_t *end, uint32_t x) {
+    uint8_t *p = end;
+    while (x >= 100) {
+        uint32_t pair = x % 100;
+        x /= 100;
+        p -= 2;
+        memcpy(p, emit_digit_pairs + 2 * pair, 2);
+    }
+    if (x >= 10) {
+        p -= 2;
+        memcpy(p, emit_digit_pairs + 2 * x, 2);
+    } else {
+        *--p = (uint8_t)('0' + x);
+    }
+    return p;
+}
+
+/* "_r<N>" and friends are the dominant tokens in the output, so the
+ * prefix goes into the same stack slot as the digits and the whole
+ * token lands in the buffer with a single bounds check and copy. */
+static void emit_prefixed_u32(JanetBuffer *buffer, char prefix, uint32_t x) {
+    uint8_t buf[16];
+    uint8_t *end = buf + sizeof(buf);
+    uint8_t *p = emit_u32_digits(end, x);
+    *--p = (uint8_t) prefix;
+    *--p = '_';
+    janet_buffer_push_bytes(buffer, p, (int32_t)(end - p));
+}
+
+static void emit_ru(JanetBuffer *buffer, uint32_t r) {
+    emit_prefixed_u32(buffer, 'r', r);
+}
+
+/* "  _r<N>" - the two-space statement indent folded into the same
+ * stack slot, for handlers whose template opens with a register. */
+static void emit_indent_ru(JanetBuffer *buffer, uint32_t r) {
+    uint8_t buf[16];
+    uint8_t *end = buf + sizeof(buf);
+    uint8_t *p = emit_u32_digits(end, r);
+    *--p = 'r';
+    *--p = '_';
+    *--p = ' ';
+    *--p = ' ';
+    janet_buffer_push_bytes(buffer, p, (int32_t)(end - p));
+}
+
+static void emit_tu(JanetBuffer *buffer, uint32_t t) {
+    emit_prefixed_u32(buffer, 't', t);
+}
+
+static void emit_fu(JanetBuffer *buffer, uint32_t f) {
+    emit_prefixed_u32(buffer, 'f', f);
+}
+
+/* Raw token write through a caller-advanced cursor with no capacity
+ * check; the caller must reserve space first. Returns the advanced
+ * cursor. */
+static uint8_t *emit_raw_token(uint8_t *w, char prefix, uint32_t x) {
+    uint8_t buf[16];
+    uint8_t *end = buf + sizeof(buf);
+    uint8_t *p = emit_u32_digits(end, x);
+    *--p = (uint8_t) prefix;
+    *--p = '_';
+    size_t n = (size_t)(end - p);
+    memcpy(w, p, n);
+    return w + n;
+}
+
+/* Worst case for "  _rA = _rB <op> _rC;\n": three 12-byte tokens plus
+ * fourteen bytes of fixed template and indent. */
+#define SYSIR_BINOP_MAX 52
+
+/* The whole binop template written through a bumped pointer after a
+ * single capacity reservation, so none of the individual pieces pays a
+ * bounds check. */
+static void emit_binop(JanetBuffer *buffer, uint32_t dest, uint32_t lhs,
+                       const char *op, int32_t op_len, uint32_t rhs) {
+    janet_buffer_extra(buffer, SYSIR_BINOP_MAX);
+    uint8_t *w = buffer->data + buffer->count;
+    *w++ = ' ';
+    *w++ = ' ';
+    w = emit_raw_token(w, 'r', dest);
+    memcpy(w, " = ", 3);
+    w += 3;
+    w = emit_raw_token(w, 'r', lhs);
+    *w++ = ' ';
+    memcpy(w, op, op_len);
+    w += op_len;
+    *w++ = ' ';
+    w = emit_raw_token(w, 'r', rhs);
+    *w++ = ';';
+    *w++ = '\n';
+    buffer->count = (int32_t)(w - buffer->data);
+}
+
+/* Decimal width by comparison ladder; feeds the sizing pass below. */
+static int32_t digits_u32(uint32_t x) {
+    if (x < 10) return 1;
+    if (x < 100) return 2;
+    if (x < 1000) return 3;
+    if (x < 10000) return 4;
+    if (x < 100000) return 5;
+    if (x < 1000000) return 6;
+    if (x < 10000000) return 7;
+    if (x < 100000000) return 8;
+    if (x < 1000000000) return 9;
+    return 10;
+}
+
+/* Upper bound on the bytes instruction i emits, label and #line prefix
+ * included. Constants lowered with %j are unbounded here, so their
+ * arms return a small base and rely on the emitters' own growth; every
+ * fixed template is covered exactly. */
+static int32_t size_instruction(const JanetSysIR *ir, uint32_t i) {
+    JanetSysInstruction instruction = ir->instructions[i];
+    int32_t size = 24 + digits_u32(i);
+    switch (ir->opcodes[i]) {
+        case JANET_SYSOP_TYPE_PRIMITIVE:
+        case JANET_SYSOP_TYPE_STRUCT:
+        case JANET_SYSOP_TYPE_BIND:
+        case JANET_SYSOP_ARG:
+            return 0;
+        case JANET_SYSOP_ADD:
+        case JANET_SYSOP_SUBTRACT:
+        case JANET_SYSOP_MULTIPLY:
+        case JANET_SYSOP_DIVIDE:
+        case JANET_SYSOP_BAND:
+        case JANET_SYSOP_BOR:
+        case JANET_SYSOP_BXOR:
+        case JANET_SYSOP_SHL:
+        case JANET_SYSOP_SHR:
+        case JANET_SYSOP_GT:
+        case JANET_SYSOP_GTE:
+        case JANET_SYSOP_LT:
+        case JANET_SYSOP_LTE:
+        case JANET_SYSOP_EQ:
+        case JANET_SYSOP_NEQ:
+            return size + 16 + digits_u32(instruction.three.dest)
+                   + digits_u32(instruction.three.lhs) + digits_u32(instruction.three.rhs);
+        case JANET_SYSOP_MOVE:
+        case JANET_SYSOP_BNOT:
+        case JANET_SYSOP_ADDRESS:
+            return size + 20 + digits_u32(instruction.two.dest) + digits_u32(instruction.two.src);
+        case JANET_SYSOP_CAST:
+        case JANET_SYSOP_LOAD:
+        case JANET_SYSOP_STORE:
+            return size + 32 + digits_u32(instruction.two.dest) + digits_u32(instruction.two.src);
+        case JANET_SYSOP_JUMP:
+            return size + 8 + digits_u32(instruction.jump.to);
+        case JANET_SYSOP_BRANCH:
+            return size + 16 + digits_u32(instruction.branch.cond) + digits_u32(instruction.branch.to);
+        case JANET_SYSOP_RETURN:
+            return size + 10 + digits_u32(instruction.one.src);
+        case JANET_SYSOP_CALL:
+            return size + 12 + 14 * (int32_t) instruction.call.arg_count
+                   + digits_u32(instruction.call.dest) + digits_u32(instruction.call.callee);
+        case JANET_SYSOP_CALLK:
+            return size + 24 + 14 * (int32_t) instruction.callk.arg_count
+                   + digits_u32(instruction.callk.dest);
+        case JANET_SYSOP_CONSTANT:
+            return size + 16 + digits_u32(instruction.constant.dest);
+        case JANET_SYSOP_FIELD_GET:
+        case JANET_SYSOP_FIELD_SET:
+            return size + 16 + digits_u32(instruction.field.r)
+                   + digits_u32(instruction.field.st) + digits_u32(instruction.field.field);
+    }
+    return size + 48;
+}
+
+/* Emit a call argument list. The ABI packs three operands per trailing
+ * ARG instruction, so the loop walks whole blocks at a time and a small
+ * switch picks up the 0-2 leftover operands; every operand is followed
+ * by ", " and the final separator is rewound off the buffer, which
+ * keeps the loop body branchless about commas. */
+static void emit_call_args(JanetBuffer *buffer, const JanetSysInstruction *arg_block, uint32_t n) {
+    for (uint32_t k = 0; k < n / 3; k++, arg_block++) {
+        emit_ru(buffer, arg_block->arg.args[0]);
+        janet_buffer_push_cstring(buffer, ", ");
+        emit_ru(buffer, arg_block->arg.args[1]);
+        janet_buffer_push_cstring(buffer, ", ");
+        emit_ru(buffer, arg_block->arg.args[2]);
+        janet_buffer_push_cstring(buffer, ", ");
+    }
+    switch (n % 3) {
+        case 2:
+            emit_ru(buffer, arg_block->arg.args[0]);
+            janet_buffer_push_cstring(buffer, ", ");
+            emit_ru(buffer, arg_block->arg.args[1]);
+            janet_buffer_push_cstring(buffer, ", ");
+            break;
+        case 1:
+            emit_ru(buffer, arg_block->arg.args[0]);
+            janet_buffer_push_cstring(buffer, ", ");
+            break;
+    }
+    if (n) buffer->count -= 2;
+    janet_buffer_push_cstring(buffer, ");\n");
+}
+
+/* Push the jdn spelling of constant idx. The first use formats in
+ * place and freezes the produced bytes into a cached string; repeated
+ * uses - a callee constant at many CALLK sites is the common case -
+ * push the cached bytes and skip the pretty printer entirely. */
+static void emit_constant_str(JanetSysIR *ir, JanetBuffer *buffer, uint32_t idx) {
+    if (NULL == ir->constant_strs) {
+        ir->constant_strs = janet_calloc(ir->constant_count, sizeof(JanetString));
+        if (NULL == ir->constant_strs && ir->constant_count) {
+            JANET_OUT_OF_MEMORY;
+        }
+    }
+    JanetString str = ir->constant_strs[idx];
+    if (NULL == str) {
+        int32_t start = buffer->count;
+        janet_formatb(buffer, "%j", ir->constants[idx]);
+        ir->constant_strs[idx] = janet_string(buffer->data + start, buffer->count - start);
+        return;
+    }
+    janet_buffer_push_bytes(buffer, str, janet_string_length(str));
+}
+
+/* Emission sinks. Lowering always composes into a JanetBuffer, since
+ * the emitters above want contiguous bytes, but a sink can drain that
+ * buffer in chunks as it fills so the full C source never has to sit
+ * in memory at once. A sink with write == NULL leaves everything in
+ * the buffer, which is the plain (sysir/to-c) behavior. */
+typedef struct {
+    void (*write)(void *ctx, const char *p, size_t n);
+    void *ctx;
+} JanetSysSink;
+
+/* Drain in 64K chunks - large enough to amortize the write calls,
+ * small enough to cap the scratch buffer at one chunk plus a single
+ * emitted instruction. */
+#define JANET_SYSIR_CHUNK_SIZE 0x10000
+
+static void sysir_file_write(void *ctx, const char *p, size_t n) {
+    if (n && !fwrite(p, n, 1, (FILE *) ctx)) {
+        janet_panic("error writing to file");
+    }
+}
+
+static void sysir_sink_drain(JanetSysSink *sink, JanetBuffer *buffer) {
+    sink->write(sink->ctx, (const char *) buffer->data, (size_t) buffer->count);
+    buffer->count = 0;
+}
+
+/* Emission uses the same label-table dispatch as the type checking
+ * pass: one indirect jump per emitted instruction under GNU C, a plain
+ * switch elsewhere. The skip over type and ARG instructions stays a
+ * byte-wise switch before dispatch, so those never reach the table. */
+#ifdef JANET_SYSIR_COMPUTED_GOTOS
+#define EM_START() goto *em_lookup[opcode];
+#define EM_END()
+#define EM_OP(op) em_label_##op :
+#else
+#define EM_START() switch (opcode) {
+#define EM_END() }
+#define EM_OP(op) case op :
+#endif
+#define em_next() continue
+
+static void janet_sys_ir_lower(JanetSysIR *ir, JanetBuffer *buffer, JanetSysSink *sink) {
+
+    /* The buffer is the only thing written here, so telling the
+     * compiler the IR arrays cannot alias it lets the base pointers
+     * stay in registers across the emission loops. */
+    const JanetSysInstruction *JANET_RESTRICT insns = ir->instructions;
+    const uint8_t *JANET_RESTRICT opcodes = ir->opcodes;
+    const uint32_t *JANET_RESTRICT types = ir->types;
+
+    if (NULL == sink->write) {
+        /* Sizing pass: sum a per-instruction upper bound plus estimates
+         * for the prelude, typedefs, signature, and declarations, then
+         * allocate once. After this the fill pass almost never grows
+         * the buffer - only oversized %j constants can still trigger
+         * the emitters' own growth. Growth factor 1 keeps the exact
+         * request. A draining sink never grows past the chunk size, so
+         * it skips this. */
+        int32_t est = 160 + 24 * (int32_t) ir->register_count
+                      + 20 * (int32_t) ir->type_def_count
+                      + 16 * (int32_t) ir->field_def_count;
+        for (uint32_t i = 0; i < ir->instruction_count; i++) {
+            est += size_instruction(ir, i);
+        }
+        janet_buffer_ensure(buffer, buffer->count + est, 1);
+    }
+
+    janet_buffer_push_cstring(buffer, "#include <stdint.h>\n#include <stdbool.h>\n\n");
+
+    /* Emit type defs. Type declarations and binds sit at the top of the
+     * assembly by convention, so rather than filtering the whole
+     * instruction array for type ops, walk the leading type section and
+     * stop at the first body instruction. The body loop below then
+     * starts where this one stopped instead of rescanning from zero. */
+    uint32_t body_start = 0;
+    for (uint32_t i = 0; i < ir->instruction_count; i++) {
+        switch (opcodes[i]) {
+            default:
+                goto done_types;
+            case JANET_SYSOP_TYPE_BIND:
+            case JANET_SYSOP_ARG:
+                body_start = i + 1;
+                continue;
+            case JANET_SYSOP_TYPE_PRIMITIVE:
+            case JANET_SYSOP_TYPE_STRUCT:
+                body_start = i + 1;
+                break;
+        }
+        JanetSysInstruction instruction = insns[i];
+        if (ir->src_locs[i].line > 0) {
+            janet_formatb(buffer, "#line %d\n", ir->src_locs[i].line);
+        }
+        switch (instruction.opcode) {
+            default:
+                break;
+            case JANET_SYSOP_TYPE_PRIMITIVE:
+                janet_buffer_push_cstring(buffer, "typedef ");
+                emit_prim_name(buffer, instruction.type_prim.prim);
+                janet_buffer_push_cstring(buffer, " ");
+                emit_tu(buffer, instruction.type_prim.dest_type);
+                janet_buffer_push_cstring(buffer, ";\n");
+                break;
+            case JANET_SYSOP_TYPE_STRUCT: {
+                janet_buffer_push_cstring(buffer, "typedef struct {\n");
+                const uint32_t *packed = ir->packed_args + instruction.type_types.arg_offset;
+                for (uint32_t j = 0; j < instruction.type_types.arg_count; j++) {
+                    janet_buffer_push_cstring(buffer, "    ");
+                    emit_tu(buffer, packed[j]);
+                    janet_buffer_push_cstring(buffer, " ");
+                    emit_fu(buffer, j);
+                    janet_buffer_push_cstring(buffer, ";\n");
+                }
+                janet_buffer_push_cstring(buffer, "} ");
+                emit_tu(buffer, instruction.type_types.dest_type);
+                janet_buffer_push_cstring(buffer, ";\n");
+                break;
+            }
+        }
+    }
+done_types:
+    janet_buffer_push_cstring(buffer, "\n");
+
+    /* Emit the function signature. The return type is the type of the
+     * first returned register, void if nothing is returned. */
+    int has_return = 0;
+    uint32_t ret_type = 0;
+    for (uint32_t i = 0; i < ir->instruction_count; i++) {
+        if (insns[i].opcode == JANET_SYSOP_RETURN) {
+            ret_type = types[insns[i].one.src];
+            has_return = 1;
+            break;
+        }
+    }
+    if (has_return) {
+        janet_formatb(buffer, "_t%u ", ret_type);
+    } else {
+        janet_buffer_push_cstring(buffer, "void ");
+    }
+    if (ir->link_name != NULL) {
+        janet_formatb(buffer, "%s(", ir->link_name);
+    } else {
+        janet_buffer_push_cstring(buffer, "_thunk(");
+    }
+    for (uint32_t i = 0; i < ir->parameter_count; i++) {
+        if (i) janet_buffer_push_cstring(buffer, ", ");
+        janet_formatb(buffer, "_t%u _r%u", types[i], i);
+    }
+    janet_buffer_push_cstring(buffer, ") {\n");
+
+    /* Declare locals. Consecutive registers usually share a type, so
+     * fold each run into one declaration: fewer emitted bytes and less
+     * C for the downstream compiler to parse. */
+    {
+        uint32_t i = ir->parameter_count;
+        while (i < ir->register_count) {
+            uint32_t t = types[i];
+            janet_buffer_push_cstring(buffer, "  ");
+            emit_tu(buffer, t);
+            janet_buffer_push_u8(buffer, ' ');
+            emit_ru(buffer, i);
+            i++;
+            while (i < ir->register_count && types[i] == t) {
+                janet_buffer_push_cstring(buffer, ", ");
+                emit_ru(buffer, i);
+                i++;
+            }
+            janet_buffer_push_cstring(buffer, ";\n");
+        }
+    }
+    janet_buffer_push_cstring(buffer, "\n");
+
+    /* Emit the body. Each emitted instruction is labeled so it can be a
+     * branch target. Instructions lowered from the same source line are
+     * common, so a #line directive only goes out when the line actually
+     * changes. */
+    int32_t last_line = -1;
+    for (uint32_t i = body_start; i < ir->instruction_count; i++) {
+        if (NULL != sink->write && buffer->count >= JANET_SYSIR_CHUNK_SIZE) {
+            sysir_sink_drain(sink, buffer);
+        }
+        /* Skipping type ops and trailing ARG blocks - the bulk of many
+         * units - touches only the opcode byte, not the instruction
+         * union, so the skip scan stays in a fraction of the cache
+         * lines. */
+        uint8_t opcode = opcodes[i];
+        switch (opcode) {
+            case JANET_SYSOP_TYPE_PRIMITIVE:
+            case JANET_SYSOP_TYPE_STRUCT:
+            case JANET_SYSOP_TYPE_BIND:
+            case JANET_SYSOP_ARG:
+                continue;
+            default:
+                break;
+        }
+        JanetSysInstruction instruction = insns[i];
+        /* Label and optional #line go out in one formatted write; the
+         * statement indent is part of every handler's own template, so
+         * no separate push pays for it. */
+        if (ir->src_locs[i].line > 0 && ir->src_locs[i].line != last_line) {
+            janet_formatb(buffer, "_i%u:\n#line %d\n", i, ir->src_locs[i].line);
+            last_line = ir->src_locs[i].line;
+        } else {
+            janet_formatb(buffer, "_i%u:\n", i);
+        }
+#ifdef JANET_SYSIR_COMPUTED_GOTOS
+        /* Keep in the same order as JanetSysOp */
+        static void *em_lookup[] = {
+            &&em_label_JANET_SYSOP_MOVE,
+            &&em_label_JANET_SYSOP_CAST,
+            &&em_label_JANET_SYSOP_ADD,
+            &&em_label_JANET_SYSOP_SUBTRACT,
+            &&em_label_JANET_SYSOP_MULTIPLY,
+            &&em_label_JANET_SYSOP_DIVIDE,
+            &&em_label_JANET_SYSOP_BAND,
+            &&em_label_JANET_SYSOP_BOR,
+            &&em_label_JANET_SYSOP_BXOR,
+            &&em_label_JANET_SYSOP_BNOT,
+            &&em_label_JANET_SYSOP_SHL,
+            &&em_label_JANET_SYSOP_SHR,
+            &&em_label_JANET_SYSOP_LOAD,
+            &&em_label_JANET_SYSOP_STORE,
+            &&em_label_JANET_SYSOP_GT,
+            &&em_label_JANET_SYSOP_LT,
+            &&em_label_JANET_SYSOP_EQ,
+            &&em_label_JANET_SYSOP_NEQ,
+            &&em_label_JANET_SYSOP_GTE,
+            &&em_label_JANET_SYSOP_LTE,
+            &&em_label_JANET_SYSOP_CONSTANT,
+            &&em_label_JANET_SYSOP_CALL,
+            &&em_label_JANET_SYSOP_RETURN,
+            &&em_label_JANET_SYSOP_JUMP,
+            &&em_label_JANET_SYSOP_BRANCH,
+            &&em_label_JANET_SYSOP_ADDRESS,
+            &&em_label_JANET_SYSOP_CALLK,
+            &&em_label_JANET_SYSOP_TYPE_PRIMITIVE,
+            &&em_label_JANET_SYSOP_TYPE_STRUCT,
+            &&em_label_JANET_SYSOP_TYPE_BIND,
+            &&em_label_JANET_SYSOP_ARG,
+            &&em_label_JANET_SYSOP_FIELD_GET,
+            &&em_label_JANET_SYSOP_FIELD_SET
+        };
+#endif
+        /* Frequency-ordered fast lane: regular binops and moves
+         * dominate real IR bodies, so they are tested for with two
+         * predictable branches before paying the indirect dispatch.
+         * Their labels below stay for the completeness of the table. */
+        if (JANET_LIKELY(c_opinfo[opcode].kind == SYSIR_CKIND_BINOP)) {
+            emit_binop(buffer, instruction.three.dest, instruction.three.lhs,
+                       c_opinfo[opcode].op, c_opinfo[opcode].op_len,
+                       instruction.three.rhs);
+            continue;
+        }
+        if (opcode == JANET_SYSOP_MOVE) {
+            janet_formatb(buffer, "  _r%u = _r%u;\n", instruction.two.dest, instruction.two.src);
+            continue;
+        }
+        EM_START()
+        EM_OP(JANET_SYSOP_ADD)
+        EM_OP(JANET_SYSOP_SUBTRACT)
+        EM_OP(JANET_SYSOP_MULTIPLY)
+        EM_OP(JANET_SYSOP_DIVIDE)
+        EM_OP(JANET_SYSOP_BAND)
+        EM_OP(JANET_SYSOP_BOR)
+        EM_OP(JANET_SYSOP_BXOR)
+        EM_OP(JANET_SYSOP_SHL)
+        EM_OP(JANET_SYSOP_SHR)
+        EM_OP(JANET_SYSOP_GT)
+        EM_OP(JANET_SYSOP_GTE)
+        EM_OP(JANET_SYSOP_LT)
+        EM_OP(JANET_SYSOP_LTE)
+        EM_OP(JANET_SYSOP_EQ)
+        EM_OP(JANET_SYSOP_NEQ)
+        emit_binop(buffer, instruction.three.dest, instruction.three.lhs,
+                   c_opinfo[opcode].op, c_opinfo[opcode].op_len,
+                   instruction.three.rhs);
+        em_next();
+        /* Never dispatched - the byte scan above skips them - but the
+         * entries keep the table total. */
+        EM_OP(JANET_SYSOP_TYPE_PRIMITIVE)
+        EM_OP(JANET_SYSOP_TYPE_STRUCT)
+        EM_OP(JANET_SYSOP_TYPE_BIND)
+        EM_OP(JANET_SYSOP_ARG)
+        em_next();
+        EM_OP(JANET_SYSOP_CONSTANT)
+        emit_indent_ru(buffer, instruction.constant.dest);
+        janet_buffer_push_cstring(buffer, " = ");
+        emit_constant_str(ir, buffer, instruction.constant.constant);
+        janet_buffer_push_cstring(buffer, ";\n");
+        em_next();
+        EM_OP(JANET_SYSOP_BNOT)
+        janet_formatb(buffer, "  _r%u = ~_r%u;\n", instruction.two.dest, instruction.two.src);
+        em_next();
+        EM_OP(JANET_SYSOP_MOVE)
+        janet_formatb(buffer, "  _r%u = _r%u;\n", instruction.two.dest, instruction.two.src);
+        em_next();
+        EM_OP(JANET_SYSOP_CAST)
+        janet_formatb(buffer, "  _r%u = (_t%u) _r%u;\n", instruction.two.dest,
+                      types[instruction.two.dest], instruction.two.src);
+        em_next();
+        EM_OP(JANET_SYSOP_LOAD)
+        emit_indent_ru(buffer, instruction.two.dest);
+        janet_buffer_push_cstring(buffer, " = *((");
+        emit_prim_name(buffer, ir->type_defs[types[instruction.two.dest]].prim);
+        janet_buffer_push_cstring(buffer, " *) ");
+        emit_ru(buffer, instruction.two.src);
+        janet_buffer_push_cstring(buffer, ");\n");
+        em_next();
+        EM_OP(JANET_SYSOP_STORE)
+        janet_buffer_push_cstring(buffer, "  *((");
+        emit_prim_name(buffer, ir->type_defs[types[instruction.two.src]].prim);
+        janet_buffer_push_cstring(buffer, " *) ");
+        emit_ru(buffer, instruction.two.dest);
+        janet_buffer_push_cstring(buffer, ") = ");
+        emit_ru(buffer, instruction.two.src);
+        janet_buffer_push_cstring(buffer, ";\n");
+        em_next();
+        EM_OP(JANET_SYSOP_ADDRESS)
+        janet_formatb(buffer, "  _r%u = (char *) &_r%u;\n", instruction.two.dest, instruction.two.src);
+        em_next();
+        EM_OP(JANET_SYSOP_JUMP)
+        janet_formatb(buffer, "  goto _i%u;\n", instruction.jump.to);
+        em_next();
+        EM_OP(JANET_SYSOP_BRANCH)
+        janet_formatb(buffer, "  if (_r%u) goto _i%u;\n", instruction.branch.cond, instruction.branch.to);
+        em_next();
+        EM_OP(JANET_SYSOP_RETURN)
+        janet_formatb(buffer, "  return _r%u;\n", instruction.one.src);
+        em_next();
+        EM_OP(JANET_SYSOP_CALL)
+        janet_formatb(buffer, "  _r%u = _r%u(", instruction.call.dest, instruction.call.callee);
+        emit_call_args(buffer, insns + i + 1, instruction.call.arg_count);
+        em_next();
+        EM_OP(JANET_SYSOP_CALLK)
+        emit_indent_ru(buffer, instruction.callk.dest);
+        janet_buffer_push_cstring(buffer, " = ");
+        emit_constant_str(ir, buffer, instruction.callk.constant);
+        janet_buffer_push_u8(buffer, '(');
+        emit_call_args(buffer, insns + i + 1, instruction.callk.arg_count);
+        em_next();
+        EM_OP(JANET_SYSOP_FIELD_GET)
+        janet_formatb(buffer, "  _r%u = _r%u._f%u;\n", instruction.field.r,
+                      instruction.field.st, instruction.field.field);
+        em_next();
+        EM_OP(JANET_SYSOP_FIELD_SET)
+        janet_formatb(buffer, "  _r%u._f%u = _r%u;\n", instruction.field.st,
+                      instruction.field.field, instruction.field.r);
+        em_next();
+        EM_END()
+    }
+
+    janet_buffer_push_cstring(buffer, "}\n");
+
+    if (NULL != sink->write) {
+        sysir_sink_drain(sink, buffer);
+    }
+}
+
+void janet_sys_ir_lower_to_c(JanetSysIR *ir, JanetBuffer *buffer) {
+    JanetSysSink sink = { NULL, NULL };
+    janet_sys_ir_lower(ir, buffer, &sink);
+}
+
+static int sysir_gc(void *p, size_t s) {
+    JanetSysIR *ir = (JanetSysIR *)p;
+    (void) s;
+    janet_free(ir->constant_strs);
+    if (ir->arena != NULL) {
+        /* Frozen: every array lives inside the arena. */
+        janet_free(ir->arena);
+        return 0;
+    }
+    /* Construction panicked before freezing; the arrays are still
+     * individual allocations. */
+    janet_free(ir->constants);
+    janet_free(ir->types);
+    janet_free(ir->reg_prims);
+    janet_free(ir->instructions);
+    janet_free(ir->opcodes);
+    janet_free(ir->src_locs);
+    janet_free(ir->type_defs);
+    janet_free(ir->field_defs);
+    janet_free(ir->packed_args);
+    return 0;
+}
+
+static int sysir_gcmark(void *p, size_t s) {
+    JanetSysIR *ir = (JanetSysIR *)p;
+    (void) s;
+    for (uint32_t i = 0; i < ir->constant_count; i++) {
+        janet_mark(ir->constants[i]);
+    }
+    if (ir->link_name != NULL) {
+        janet_mark(janet_wrap_string(ir->link_name));
+    }
+    if (ir->scratch != NULL) {
+        janet_mark(janet_wrap_buffer(ir->scratch));
+    }
+    if (ir->constant_strs != NULL) {
+        for (uint32_t i = 0; i < ir->constant_count; i++) {
+            if (ir->constant_strs[i] != NULL) {
+                janet_mark(janet_wrap_string(ir->constant_strs[i]));
+            }
+        }
+    }
+    return 0;
+}
+
+static const JanetAbstractType janet_sysir_type = {
+    "core/sysir",
+    sysir_gc,
+    sysir_gcmark,
+    JANET_ATEND_GCMARK
+};
+
+JANET_CORE_FN(cfun_sysir_asm,
+              "(sysir/asm assembly)",
+              "Compile the system dialect IR into an object that can be manipulated, "
+              "optimized, and lowered to other targets like C.") {
+    janet_fixarity(argc, 1);
+    JanetTable *tab = janet_gettable(argv, 0);
+    JanetSysIR *sysir = janet_abstract(&janet_sysir_type, sizeof(JanetSysIR));
+    janet_sys_ir_init_from_table(sysir, tab);
+    return janet_wrap_abstract(sysir);
+}
+
+JANET_CORE_FN(cfun_sysir_toc,
+              "(sysir/to-c sysir &opt buffer)",
+              "Lower some IR to a C function. Return a modified buffer that can be "
+              "dumped to a file and compiled. If no buffer is given, an internal "
+              "scratch buffer is reused across calls - pass a buffer to keep the "
+              "result past the next lowering.") {
+    janet_arity(argc, 1, 2);
+    JanetSysIR *ir = janet_getabstract(argv, 0, &janet_sysir_type);
+    JanetBuffer *buffer;
+    if (argc >= 2) {
+        buffer = janet_getbuffer(argv, 1);
+    } else if (ir->scratch != NULL) {
+        buffer = ir->scratch;
+        buffer->count = 0;
+    } else {
+        buffer = janet_buffer(0);
+        ir->scratch = buffer;
+    }
+    janet_sys_ir_lower_to_c(ir, buffer);
+    return janet_wrap_buffer(buffer);
+}
+
+JANET_CORE_FN(cfun_sysir_toc_file,
+              "(sysir/to-c-file sysir file)",
+              "Lower some IR to a C function, writing the source to an open file "
+              "as it is generated instead of collecting it all in a buffer. "
+              "Returns the file.") {
+    janet_fixarity(argc, 2);
+    JanetSysIR *ir = janet_getabstract(argv, 0, &janet_sysir_type);
+    int32_t flags = 0;
+    FILE *f = janet_getfile(argv, 1, &flags);
+    if (flags & JANET_FILE_CLOSED)
+        janet_panic("file is closed");
+    if (!(flags & (JANET_FILE_WRITE | JANET_FILE_APPEND | JANET_FILE_UPDATE)))
+        janet_panic("file is not writeable");
+    JanetBuffer *buffer = janet_buffer(JANET_SYSIR_CHUNK_SIZE);
+    JanetSysSink sink = { sysir_file_write, f };
+    janet_sys_ir_lower(ir, buffer, &sink);
+    return argv[1];
+}
+
+void janet_lib_sysir(JanetTable *env) {
+    if (!sysop_hash_ready) {
+        sysop_hash_init();
+    }
+    JanetRegExt cfuns[] = {
+        JANET_CORE_REG("sysir/asm", cfun_sysir_asm),
+        JANET_CORE_REG("sysir/to-c", cfun_sysir_toc),
+        JANET_CORE_REG("sysir/to-c-file", cfun_sysir_toc_file),
+        JANET_REG_END
+    };
+    janet_core_cfuns_ext(env, NULL, cfuns);
+}
@@ -64,6 +64,24 @@
     if (!(c)) JANET_EXIT((m)); \
 } while (0)
 
+/* Branch hints for rarely-taken error paths, so compilers keep the
+ * panic calls out of the hot fall-through code. */
+#ifdef __GNUC__
+#define JANET_LIKELY(x) __builtin_expect(!!(x), 1)
+#define JANET_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define JANET_LIKELY(x) (x)
+#define JANET_UNLIKELY(x) (x)
+#endif
+
+/* MSVC only accepts the C99 restrict keyword in its newer C modes, but
+ * always understands the vendor spelling. */
+#ifdef _MSC_VER
+#define JANET_RESTRICT __restrict
+#else
+#define JANET_RESTRICT restrict
+#endif
+
 /* Utils */
 uint32_t janet_hash_mix(uint32_t input, uint32_t more);
 #define janet_maphash(cap, hash) ((uint32_t)(hash) & (cap - 1))
@@ -187,6 +205,7 @@ void janet_lib_asm(JanetTable *env);
 #endif
 void janet_lib_compile(JanetTable *env);
 void janet_lib_debug(JanetTable *env);
+void janet_lib_sysir(JanetTable *env);
 #ifdef JANET_PEG
 void janet_lib_peg(JanetTable *env);
 #endif
@@ -38,6 +38,30 @@ void *janet_v_grow(void *v, int32_t increment, int32_t itemsize) {
     return p + 2;
 }
 
+/* Convert a buffer to normal allocated memory, release the scratch
+ * vector, and report the element count. Scratch memory and malloc'd
+ * memory come from different allocators so the payload cannot be
+ * reshaped in place, but freeing the scratch copy immediately instead
+ * of leaving it for the collector keeps peak usage flat for large
+ * vectors. */
+void *janet_v_takemem(void *v, int32_t itemsize, int32_t *count) {
+    char *p;
+    if (NULL == v) {
+        if (NULL != count) *count = 0;
+        return NULL;
+    }
+    int32_t n = janet_v__cnt(v);
+    size_t size = (size_t) itemsize * n;
+    p = janet_malloc(size);
+    if (NULL == p) {
+        JANET_OUT_OF_MEMORY;
+    }
+    safe_memcpy(p, v, size);
+    janet_sfree(janet_v__raw(v));
+    if (NULL != count) *count = n;
+    return p;
+}
+
 /* Convert a buffer to normal allocated memory (forget capacity) */
 void *janet_v_flattenmem(void *v, int32_t itemsize) {
     char *p;
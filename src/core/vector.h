@@ -44,6 +44,7 @@
 #define janet_v_last(v)         ((v)[janet_v__cnt(v) - 1])
 #define janet_v_empty(v)        (((v) != NULL) ? (janet_v__cnt(v) = 0) : 0)
 #define janet_v_flatten(v)      (janet_v_flattenmem((v), sizeof(*(v))))
+#define janet_v_take(v, count)  (janet_v_takemem((v), sizeof(*(v)), (count)))
 
 #define janet_v__raw(v) ((int32_t *)(v) - 2)
 #define janet_v__cap(v) janet_v__raw(v)[0]
@@ -56,5 +57,6 @@
 /* Actual functions defined in vector.c */
 void *janet_v_grow(void *v, int32_t increment, int32_t itemsize);
 void *janet_v_flattenmem(void *v, int32_t itemsize);
+void *janet_v_takemem(void *v, int32_t itemsize, int32_t *count);
 
 #endif